@@ -2,44 +2,141 @@
 #include <bitset>
 #include <string>
 #include <sstream>
+#include <new>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef ADDRESSTABLE_COMPACT_NODES
+#include <sys/mman.h>
+#endif
 #include "AddressTable.h"
+#include "UpdateJournal.h"
+
+#ifdef ADDRESSTABLE_COMPACT_NODES
+//every table reserves address range for its nodes and makes it accessible in steps as the tree grows
+static const std::size_t POOL_BYTES = (std::size_t)1 << 32;
+static const std::size_t POOL_STEP = 1 << 20;
+static const unsigned int LINK_MASK = 0x1FFFFFFF;
+#endif
 
 //inner class to handle nodes in the interval tree
+#ifdef ADDRESSTABLE_COMPACT_NODES
+AddressTable::Node::Node(unsigned int b, char m):base(b), mask(m), l(0), r(0){
+	setHeight(1);
+#else
 AddressTable::Node::Node(unsigned int b, char m):base(b), h(1), left(nullptr), right(nullptr), mask(m){
+#endif
 
 	if( m > 0 && m < 32){
 		mask = (unsigned int)1 << (m-1);
 		//we only take as important bits of address those bits that are covered by mask;
 		base = b & (((unsigned int)(~0)) << (32-m));
 
-		//calculate maximum address generated by the mask
-		top = (((unsigned int)(~0)) >> m) | this->base;
-
 		//set initial value for max parameter used in interval tree
-		max = top;
+		max = updateTop();
 	}
 	else{ //m==32
-		max = base = top = b;
+		max = base = b;
 		mask = 0x80000000;
+		updateTop();
 	}
 }
 
 AddressTable::Node::~Node(){
+#ifndef ADDRESSTABLE_COMPACT_NODES
 	if( nullptr != left )
 		delete left;
 	if( nullptr != right )
 		delete right;
+#endif
 }
 
-//returns smallest mask in node
-char AddressTable::Node::getMask(){
+#ifdef ADDRESSTABLE_COMPACT_NODES
+//child link is a signed offset from this node in node sizes, all nodes of a table are in one pool
+AddressTable::Node* AddressTable::Node::fromLink(unsigned int link){
+	int offset = ((int)(link << 3)) >> 3;
+	return offset ? this + offset : nullptr;
+}
 
-	char c=32;
-	unsigned int m = mask;
-	while( m != 0){
-		c--; m<<=1;
-	}
-	return c+1;
+unsigned int AddressTable::Node::toLink(AddressTable::Node* n){
+	return (nullptr == n) ? 0 : ((unsigned int)(n - this) & LINK_MASK);
+}
+
+AddressTable::Node* AddressTable::Node::getLeft(){
+	return fromLink(l);
+}
+
+AddressTable::Node* AddressTable::Node::getRight(){
+	return fromLink(r);
+}
+
+void AddressTable::Node::setLeft(AddressTable::Node* n){
+	l = (l & ~LINK_MASK) | toLink(n);
+}
+
+void AddressTable::Node::setRight(AddressTable::Node* n){
+	r = (r & ~LINK_MASK) | toLink(n);
+}
+
+//links are relative, so they have to be recalculated for the new location
+void AddressTable::Node::copyFrom(AddressTable::Node* n){
+	base = n->base;
+	mask = n->mask;
+	max = n->max;
+	setLeft(n->getLeft());
+	setRight(n->getRight());
+	setHeight(n->getHeight());
+}
+
+//height is split between three spare bits of each child index
+unsigned int AddressTable::Node::getHeight(){
+	return ((l >> 29) << 3) | (r >> 29);
+}
+
+void AddressTable::Node::setHeight(unsigned int height){
+	l = (l & LINK_MASK) | ((height >> 3) << 29);
+	r = (r & LINK_MASK) | ((height & 7) << 29);
+}
+
+//top is not stored, it is calculated from the base and lowest bit in the mask
+unsigned int AddressTable::Node::getTop(){
+	return base | (((unsigned int)(~0)) >> 1 >> __builtin_ctz(mask));
+}
+
+unsigned int AddressTable::Node::updateTop(){
+	return getTop();
+}
+#else
+AddressTable::Node* AddressTable::Node::getLeft(){
+	return left;
+}
+
+AddressTable::Node* AddressTable::Node::getRight(){
+	return right;
+}
+
+void AddressTable::Node::setLeft(AddressTable::Node* n){
+	left = n;
+}
+
+void AddressTable::Node::setRight(AddressTable::Node* n){
+	right = n;
+}
+
+void AddressTable::Node::copyFrom(AddressTable::Node* n){
+	*this = *n;
+}
+
+unsigned int AddressTable::Node::getHeight(){
+	return h;
+}
+
+void AddressTable::Node::setHeight(unsigned int height){
+	h = height;
+}
+
+unsigned int AddressTable::Node::getTop(){
+	return top;
 }
 
 //calculates top value using lowest bit in the mask
@@ -51,24 +148,32 @@ unsigned int AddressTable::Node::updateTop(){
 	return top = (((unsigned int)(~0)) >> m) | this->base;
 
 }
+#endif
 
-unsigned int AddressTable::Node::getHeight(){
-	return h;
+//returns smallest mask in node
+char AddressTable::Node::getMask(){
+
+	char c=32;
+	unsigned int m = mask;
+	while( m != 0){
+		c--; m<<=1;
+	}
+	return c+1;
 }
 
 int AddressTable::Node::getBalance(){
-	int l = (left!=nullptr)?left->getHeight():0;
-	int r = (right!=nullptr)?right->getHeight():0;
+	int l = (getLeft()!=nullptr)?getLeft()->getHeight():0;
+	int r = (getRight()!=nullptr)?getRight()->getHeight():0;
 	return l-r;
 }
 
 //update root's max
 void AddressTable::Node::updateMax(){
-	unsigned int l = (nullptr!=left)?left->getMax():0;
-	unsigned int r = (nullptr!=right)?right->getMax():0;
+	unsigned int l = (nullptr!=getLeft())?getLeft()->getMax():0;
+	unsigned int r = (nullptr!=getRight())?getRight()->getMax():0;
 	unsigned int m = l>r ? l : r;
 
-	max = top;
+	max = getTop();
 	max = ((m>max)?m:max);
 }
 
@@ -78,65 +183,133 @@ unsigned int AddressTable::Node::getMax(){
 
 AddressTable::Node* AddressTable::Node::minValueNode(){
 	Node* min = this;
-	while( nullptr != min->left ){
-		min = min->left;
+	while( nullptr != min->getLeft() ){
+		min = min->getLeft();
 	}
 	return min;
 }
 
 //function for rotating interval tree around root node to right
 AddressTable::Node* AddressTable::Node::rotateRight(AddressTable::Node* y){
-	AddressTable::Node* x = y->left;
-	AddressTable::Node* T3 = x->right;
+	AddressTable::Node* x = y->getLeft();
+	AddressTable::Node* T3 = x->getRight();
 
 	// perform rotation
-	x->right = y;
-	y->left = T3;
+	x->setRight(y);
+	y->setLeft(T3);
 
 	// update max values
 	y->updateMax();
 
 	// update heights
-	int lh = (nullptr!=y->left) ? y->left->getHeight() : 0;
-	int rh = (nullptr!=y->right)? y->right->getHeight(): 0;
-	y->h = (lh>rh?lh:rh)+1;
-	lh = (nullptr!=x->left) ? x->left->getHeight() : 0;
-	rh = (nullptr!=x->right)? x->right->getHeight(): 0;
-	x->h = (lh>rh?lh:rh)+1;
+	int lh = (nullptr!=y->getLeft()) ? y->getLeft()->getHeight() : 0;
+	int rh = (nullptr!=y->getRight())? y->getRight()->getHeight(): 0;
+	y->setHeight((lh>rh?lh:rh)+1);
+	lh = (nullptr!=x->getLeft()) ? x->getLeft()->getHeight() : 0;
+	rh = (nullptr!=x->getRight())? x->getRight()->getHeight(): 0;
+	x->setHeight((lh>rh?lh:rh)+1);
 
 	return x;
 }
 
 //function for rotating interval tree around root node to left
 AddressTable::Node* AddressTable::Node::rotateLeft(AddressTable::Node* x){
-	AddressTable::Node* y = x->right;
-	AddressTable::Node* T2 = y->left;
+	AddressTable::Node* y = x->getRight();
+	AddressTable::Node* T2 = y->getLeft();
 
 	// perform rotation
-	y->left = x;
-	x->right = T2;
+	y->setLeft(x);
+	x->setRight(T2);
 
 	// update max values
 	y->updateMax();
 
 	// update heights
-	int lh = (nullptr!=x->left) ? x->left->getHeight() : 0;
-	int rh = (nullptr!=x->right)? x->right->getHeight(): 0;
-	x->h = (lh>rh?lh:rh)+1;
-	lh = (nullptr!=y->left) ? y->left->getHeight() : 0;
-	rh = (nullptr!=y->right)? y->right->getHeight(): 0;
-	y->h = (lh>rh?lh:rh)+1;
+	int lh = (nullptr!=x->getLeft()) ? x->getLeft()->getHeight() : 0;
+	int rh = (nullptr!=x->getRight())? x->getRight()->getHeight(): 0;
+	x->setHeight((lh>rh?lh:rh)+1);
+	lh = (nullptr!=y->getLeft()) ? y->getLeft()->getHeight() : 0;
+	rh = (nullptr!=y->getRight())? y->getRight()->getHeight(): 0;
+	y->setHeight((lh>rh?lh:rh)+1);
 
 
 	return y;
 }
 
-AddressTable::AddressTable():root(nullptr), zero(false), res(false){
+#ifdef ADDRESSTABLE_COMPACT_NODES
+AddressTable::AddressTable():root(nullptr), zero(false), res(false), merged(false), journal(nullptr), pool(nullptr), committed(0), next(1), freeList(0), live(0){
+}
+#else
+AddressTable::AddressTable():root(nullptr), zero(false), res(false), merged(false), journal(nullptr){
 }
+#endif
 
 AddressTable::~AddressTable(){
+	destroy();
+}
+
+AddressTable::Node* AddressTable::newNode(unsigned int b, char m){
+#ifdef ADDRESSTABLE_COMPACT_NODES
+	if( nullptr == pool ){
+		//only address range is reserved, memory is committed in steps
+		void* p = mmap(nullptr, POOL_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if( MAP_FAILED == p )
+			throw std::bad_alloc();
+		pool = static_cast<char*>(p);
+	}
+	std::size_t i;
+	if( freeList ){
+		//reuse freed slot, free slots are linked through the left link
+		i = freeList;
+		freeList = reinterpret_cast<Node*>(pool + i * sizeof(Node))->l;
+	}
+	else{
+		if( (next + 1) * sizeof(Node) > committed ){
+			if( committed + POOL_STEP > POOL_BYTES || mprotect(pool + committed, POOL_STEP, PROT_READ | PROT_WRITE) != 0 )
+				throw std::bad_alloc();
+			committed += POOL_STEP;
+		}
+		i = next++;
+	}
+	live++;
+	return new (pool + i * sizeof(Node)) Node(b, m);
+#else
+	return new Node(b, m);
+#endif
+}
+
+void AddressTable::freeNode(AddressTable::Node* n){
+#ifdef ADDRESSTABLE_COMPACT_NODES
+	n->~Node();
+	n->l = freeList;
+	freeList = n - reinterpret_cast<Node*>(pool);
+	//memory is returned to the system with the last node
+	if( 0 == --live ){
+		munmap(pool, POOL_BYTES);
+		pool = nullptr;
+		committed = 0;
+		next = 1;
+		freeList = 0;
+	}
+#else
+	delete n;
+#endif
+}
+
+void AddressTable::destroy(){
+#ifdef ADDRESSTABLE_COMPACT_NODES
+	if( nullptr != pool )
+		munmap(pool, POOL_BYTES);
+	pool = nullptr;
+	committed = 0;
+	next = 1;
+	freeList = 0;
+	live = 0;
+#else
 	if( nullptr != root )
 		delete root;
+#endif
+	root = nullptr;
 }
 
 
@@ -146,9 +319,9 @@ AddressTable::Node* AddressTable::insertNode( AddressTable::Node* root, AddressT
 		return nnode;
 	//left, right or equal base
 	if (nnode->base < root->base )
-		root->left = insertNode(root->left, nnode);
+		root->setLeft(insertNode(root->getLeft(), nnode));
 	else if (nnode->base > root->base )
-		root->right = insertNode(root->right, nnode);
+		root->setRight(insertNode(root->getRight(), nnode));
 	else{ // Equal base
 		//base and mask is already added
 		if( root->mask & nnode->mask){
@@ -156,6 +329,7 @@ AddressTable::Node* AddressTable::insertNode( AddressTable::Node* root, AddressT
 		}// add mask to the set for given base and update top
 		else{
 			root->mask |= nnode->mask;
+			merged = true;
 			root->updateTop();
 			//update max value of root
 			root->updateMax();
@@ -165,32 +339,32 @@ AddressTable::Node* AddressTable::insertNode( AddressTable::Node* root, AddressT
 	}
 
 	//update height of this ancestor node
-	unsigned int l = (nullptr!=root->left)?root->left->getHeight():0;
-	unsigned int r = (nullptr!=root->right)?root->right->getHeight():0;
-	root->h = 1 + ((l>r)?l:r);
+	unsigned int l = (nullptr!=root->getLeft())?root->getLeft()->getHeight():0;
+	unsigned int r = (nullptr!=root->getRight())?root->getRight()->getHeight():0;
+	root->setHeight(1 + ((l>r)?l:r));
 
 	//get the balance factor of this ancestor node to check whether this node became unbalanced
 	int balance = root->getBalance();
 
 	//left left case
-	if (balance > 1 && nnode->base < root->left->base)
+	if (balance > 1 && nnode->base < root->getLeft()->base)
 		return root->rotateRight(root);
 
 	//right right case
-	if (balance < -1 && nnode->base > root->right->base)
+	if (balance < -1 && nnode->base > root->getRight()->base)
 		return root->rotateLeft(root);
 
 	//left right case
-	if (balance > 1 && nnode->base > root->left->base)
+	if (balance > 1 && nnode->base > root->getLeft()->base)
 	{
-		root->left = root->rotateLeft(root->left);
+		root->setLeft(root->rotateLeft(root->getLeft()));
 		return root->rotateRight(root);
 	}
 
 	//right left case
-	if (balance < -1 && nnode->base < root->right->base)
+	if (balance < -1 && nnode->base < root->getRight()->base)
 	{
-		root->right = root->rotateRight(root->right);
+		root->setRight(root->rotateRight(root->getRight()));
 		return root->rotateLeft(root);
 	}
 
@@ -208,11 +382,11 @@ AddressTable::Node* AddressTable::deleteNode(AddressTable::Node* root, unsigned
 
 	//if the base to be deleted is smaller than the root's base, then it lies in left subtree
 	if ( base < root->base)
-		root->left = deleteNode(root->left, base, mask);
+		root->setLeft(deleteNode(root->getLeft(), base, mask));
 
 	//if the base to be deleted is greater than the root's key, then it lies in right subtree
 	else if( base > root->base )
-		root->right = deleteNode(root->right, base, mask );
+		root->setRight(deleteNode(root->getRight(), base, mask ));
 
 	//if base is same as root's base, then this is the node to be deleted or where mask is going to be modified
 	else
@@ -233,9 +407,9 @@ AddressTable::Node* AddressTable::deleteNode(AddressTable::Node* root, unsigned
 		}
 		else{
 			// node with only one child or no child
-			if( (root->left == NULL) || (root->right == NULL) )
+			if( (root->getLeft() == NULL) || (root->getRight() == NULL) )
 			{
-				Node *temp = root->left ? root->left : root->right;
+				Node *temp = root->getLeft() ? root->getLeft() : root->getRight();
 
 				// No child case
 				if (temp == NULL)
@@ -244,13 +418,13 @@ AddressTable::Node* AddressTable::deleteNode(AddressTable::Node* root, unsigned
 					root = NULL;
 				}
 				else //one child case
-					*root = *temp; //copy the contents of the non-empty child
-				delete temp;
+					root->copyFrom(temp); //copy the contents of the non-empty child
+				freeNode(temp);
 			}
 			else
 			{
 				//node with two children. Get the successor (smallest in the right subtree)
-				Node* temp = root->right->minValueNode();
+				Node* temp = root->getRight()->minValueNode();
 
 				//copy the successor's data to this node
 				root->base = temp->base;
@@ -259,7 +433,7 @@ AddressTable::Node* AddressTable::deleteNode(AddressTable::Node* root, unsigned
 				//set mask to have only one bit set
 				temp->mask = 1;
 				//delete temp node
-				root->right = deleteNode(root->right, temp->base, temp->mask);
+				root->setRight(deleteNode(root->getRight(), temp->base, temp->mask));
 
 				root->updateTop();
 				root->updateMax();
@@ -272,32 +446,32 @@ AddressTable::Node* AddressTable::deleteNode(AddressTable::Node* root, unsigned
 	  return root;
 
 	//update height of current node
-	int lh = (nullptr!=root->left)?root->left->getHeight():0;
-	int rh = (nullptr!=root->right)?root->right->getHeight():0;
-	root->h = 1 + ((lh>rh)?lh:rh);
+	int lh = (nullptr!=root->getLeft())?root->getLeft()->getHeight():0;
+	int rh = (nullptr!=root->getRight())?root->getRight()->getHeight():0;
+	root->setHeight(1 + ((lh>rh)?lh:rh));
 
 	// check whether this node became unbalanced
 	int balance = root->getBalance();
 
 	//left left case
-	if (balance > 1 && root->left->getBalance() >= 0)
+	if (balance > 1 && root->getLeft()->getBalance() >= 0)
 		return root->rotateRight(root);
 
 	//left right case
-	if (balance > 1 && root->left->getBalance() < 0)
+	if (balance > 1 && root->getLeft()->getBalance() < 0)
 	{
-		root->left = root->rotateLeft(root->left);
+		root->setLeft(root->rotateLeft(root->getLeft()));
 		return root->rotateRight(root);
 	}
 
 	//right right case
-	if (balance < -1 && root->right->getBalance() <= 0)
+	if (balance < -1 && root->getRight()->getBalance() <= 0)
 		return root->rotateLeft(root);
 
 	//right left case
-	if (balance < -1 && root->right->getBalance() > 0)
+	if (balance < -1 && root->getRight()->getBalance() > 0)
 	{
-		root->right = root->rotateRight(root->right);
+		root->setRight(root->rotateRight(root->getRight()));
 		return root->rotateLeft(root);
 	}
 
@@ -317,25 +491,31 @@ int AddressTable::add( std::string s ){
 
 int AddressTable::add(unsigned int base, char mask){
 	res = true;
+	merged = false;
 	//0 mask case
 	if( mask == 0 ){
 		if( zero )
 			return -1;
 		zero = true;
+		if( journal )
+			journal->append(UpdateJournal::ADD, base, mask);
 		return 0;
 	}
 	//check if mask is equal or lower than 32 and greater than 0
 	if(mask<0 || mask>32 )
 		return -1;
 	//create new node object
-	AddressTable::Node* an = new AddressTable::Node(base, mask);
+	AddressTable::Node* an = newNode(base, mask);
 	//insert new
 	root = insertNode( root, an);
 
-	if( !res ){
-		delete an;
+	//new node isn't part of the tree when prefix exists or its mask was merged into the node with equal base
+	if( !res || merged )
+		freeNode(an);
+	if( !res )
 		return -1;
-	}
+	if( journal )
+		journal->append(UpdateJournal::ADD, base, mask);
 	return 0;
 }
 
@@ -352,6 +532,8 @@ int AddressTable::del(unsigned int base, char mask){
 	if( mask == 0 ){
 		if( zero ){
 			zero = false;
+			if( journal )
+				journal->append(UpdateJournal::DEL, base, mask);
 			return 0;
 		}
 		return -1;
@@ -365,13 +547,15 @@ int AddressTable::del(unsigned int base, char mask){
 	if( !res )
 		return -1;
 
+	if( journal )
+		journal->append(UpdateJournal::DEL, base, mask);
 	return 0;
 }
 
 void AddressTable::search(AddressTable::Node* root, unsigned int value, AddressTable::Node** maxa){
 
 	//check ip fits in the interval
-	if( root->base <= value && value <= root->top ){
+	if( root->base <= value && value <= root->getTop() ){
 		//no appropriate interval found previously
 		if(nullptr == *maxa )
 			*maxa = root;
@@ -383,10 +567,10 @@ void AddressTable::search(AddressTable::Node* root, unsigned int value, AddressT
 		}
 	}
 	//search left and right leafs if they exist
-	if( root->left && root->left->max >= value )
-		search( root->left, value, maxa );
-	if( root->right && root->right->max >= value )
-		search( root->right, value, maxa );
+	if( root->getLeft() && root->getLeft()->max >= value )
+		search( root->getLeft(), value, maxa );
+	if( root->getRight() && root->getRight()->max >= value )
+		search( root->getRight(), value, maxa );
 }
 
 char AddressTable::check(std::string s){
@@ -446,5 +630,111 @@ bool AddressTable::string2ip(std::string s, unsigned int* ip, char* mask){
 	return true;
 }
 
+void AddressTable::setJournal(UpdateJournal* j){
+	journal = j;
+}
+
+UpdateJournal* AddressTable::getJournal(){
+	return journal;
+}
+
+bool AddressTable::isEmpty(){
+	return nullptr == root && !zero;
+}
+
+void AddressTable::collect(AddressTable::Node* root, std::vector<std::pair<unsigned int, char>>& out){
+	if( nullptr == root )
+		return;
+	collect(root->getLeft(), out);
+	//every bit in the mask is a separate prefix with the same base
+	for(char m=1; m<=32; m++)
+		if( root->mask & (((unsigned int)(1)) << (m-1)) )
+			out.push_back(std::make_pair(root->base, m));
+	collect(root->getRight(), out);
+}
+
+void AddressTable::prefixes(std::vector<std::pair<unsigned int, char>>& out){
+	out.clear();
+	if( zero )
+		out.push_back(std::make_pair(0u, (char)0));
+	collect(root, out);
+}
+
+AddressTable::Node* AddressTable::buildNode(const std::vector<std::pair<unsigned int, unsigned int>>& nodes, std::size_t lo, std::size_t hi){
+	if( lo >= hi )
+		return nullptr;
+	std::size_t mid = lo + (hi - lo) / 2;
+
+	//node is created with any of its masks, then all mask bits are set
+	Node* n = newNode(nodes[mid].first, 32);
+	n->mask = nodes[mid].second;
+	n->updateTop();
+	n->setLeft(buildNode(nodes, lo, mid));
+	n->setRight(buildNode(nodes, mid + 1, hi));
+
+	unsigned int l = (nullptr!=n->getLeft())?n->getLeft()->getHeight():0;
+	unsigned int r = (nullptr!=n->getRight())?n->getRight()->getHeight():0;
+	n->setHeight(1 + ((l>r)?l:r));
+	n->updateMax();
+	return n;
+}
+
+int AddressTable::build(const std::vector<std::pair<unsigned int, char>>& sorted){
+	//merge prefixes with the same base into one node
+	std::vector<std::pair<unsigned int, unsigned int>> nodes;
+	bool z = false;
+	for(std::size_t i=0; i<sorted.size(); i++){
+		char m = sorted[i].second;
+		if( m < 0 || m > 32 )
+			return -1;
+		if( 0 == m ){
+			if( z )
+				return -1;
+			z = true;
+			continue;
+		}
+		unsigned int b = sorted[i].first & (~(unsigned int)0<<(32-m));
+		unsigned int bit = ((unsigned int)(1)) << (m-1);
+		if( !nodes.empty() && nodes.back().first == b ){
+			if( nodes.back().second & bit )
+				return -1;
+			nodes.back().second |= bit;
+		}
+		else if( nodes.empty() || nodes.back().first < b )
+			nodes.push_back(std::make_pair(b, bit));
+		else
+			return -1;
+	}
+
+	destroy();
+	root = buildNode(nodes, 0, nodes.size());
+	zero = z;
+	return 0;
+}
+
+void AddressTable::account(AddressTable::Node* root, AddressTable::MemoryUsage& usage){
+	if( nullptr == root )
+		return;
+	usage.nodes++;
+	usage.nodeBytes += sizeof(Node);
+#if !defined(ADDRESSTABLE_COMPACT_NODES) && defined(__GLIBC__)
+	//chunk header and rounding of the chunk size
+	usage.allocatorBytes += malloc_usable_size(root) + sizeof(std::size_t) - sizeof(Node);
+#endif
+	account(root->getLeft(), usage);
+	account(root->getRight(), usage);
+}
+
+AddressTable::MemoryUsage AddressTable::memoryUsage(){
+	MemoryUsage usage = {0, 0, 0, sizeof(AddressTable), 0};
+	account(root, usage);
+#ifdef ADDRESSTABLE_COMPACT_NODES
+	//accessible part of the pool that doesn't hold live nodes, including unused slot 0
+	usage.allocatorBytes = committed - live * sizeof(Node);
+#endif
+	usage.total = usage.nodeBytes + usage.allocatorBytes + usage.auxiliaryBytes;
+	return usage;
+}
+
 
 
@@ -2,6 +2,11 @@
 #define ADDRESSTABLE_H_
 
 #include <string>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+class UpdateJournal;
 
 /**
 	 * Class that represents range of IP addresses
@@ -17,12 +22,19 @@ class AddressTable {
 	 */
 	class Node{
 	public:
+#ifdef ADDRESSTABLE_COMPACT_NODES
+		unsigned int base;	/** starting address of the addresses range.*/
+		unsigned int mask;	/** Holds information about masks with the same base. */
+		unsigned int max;	/** maximum value of the addresses range from left and right children and current node. */
+		unsigned int l,r;	/** Offsets of the left and right children from this node in lower 29 bits, upper 3 bits of each hold part of the node's height. */
+#else
 		unsigned int base;	/** starting address of the addresses range.*/
 		unsigned int h;		/** Height of the node in the tree. For leafs h==1. */
 		Node  *left,*right; /** Pointers the left and right children. */
 		unsigned int mask;	/** Holds information about masks with the same base. */
 		unsigned int top; 	/** Holds value of the base with applied mask. */
 		unsigned int max;	/** maximum value of the addresses range from left and right children and current node. */
+#endif
 		/**
 		 * @brief Constructor that accepts base address and mask.
 		 * @param [in] b Base value of the IP prefix.
@@ -30,7 +42,7 @@ class AddressTable {
 		 */
 		Node(unsigned int b, char m);
 		/**
-		 * Destructor responsible for removing children objects in the tree.
+		 * Destructor responsible for removing children objects in the tree. With ADDRESSTABLE_COMPACT_NODES children are released together with the table's pool.
 		 */
 		~Node();
 		/**
@@ -43,11 +55,41 @@ class AddressTable {
 		 * @return Returns new top value for given node.
 		 */
 		unsigned int updateTop();
+		/**
+		 * @brief Method that returns value of the base with applied smallest mask.
+		 * @return Returns highest address of the widest prefix in the node.
+		 */
+		unsigned int getTop();
 		/**
 		 * @brief Method that returns height of the node.
 		 * @return Returns level of the node in the tree.
 		 */
 		unsigned int getHeight();
+		/**
+		 * @brief Method that sets height of the node.
+		 * @param [in] height New level of the node in the tree.
+		 */
+		void setHeight(unsigned int height);
+		/**
+		 * @brief Returns left child of the node.
+		 * @return Pointer to the left child or null pointer.
+		 */
+		Node* getLeft();
+		/**
+		 * @brief Returns right child of the node.
+		 * @return Pointer to the right child or null pointer.
+		 */
+		Node* getRight();
+		/**
+		 * @brief Sets left child of the node.
+		 * @param [in] n Pointer to the new left child. Can be null pointer.
+		 */
+		void setLeft(Node* n);
+		/**
+		 * @brief Sets right child of the node.
+		 * @param [in] n Pointer to the new right child. Can be null pointer.
+		 */
+		void setRight(Node* n);
 		/**
 		 * @brief Method that calculates whether and how node is of the balance (difference between height of left and right children is greater than 1).
 		 * @return Returns integer that informs about difference of number of tree levels between left and right children nodes. Positive if Left children has more levels, negative otherwise. Zero is returned when both children have same height in tree.
@@ -79,12 +121,78 @@ class AddressTable {
 		 * @return new root node of the rotated subtree.
 		 */
 		AddressTable::Node* rotateLeft(AddressTable::Node* x);
+		/**
+		 * @brief Copies content of other node, including links to its children.
+		 * @param [in] n Node that is copied.
+		 */
+		void copyFrom(Node* n);
+#ifdef ADDRESSTABLE_COMPACT_NODES
+		/**
+		 * @brief Converts child link to the node's pointer.
+		 * @param [in] link Child link, bits above offset part are ignored. 0 stands for null pointer.
+		 */
+		Node* fromLink(unsigned int link);
+		/**
+		 * @brief Converts node's pointer to the child link.
+		 * @param [in] n Node from the same pool or null pointer.
+		 */
+		unsigned int toLink(Node* n);
+#endif
 	};
 
 	Node* root; /** top level node of the tree. */
 	bool zero;  /** Variable for /0 prefix. true when this address and mask is added. */
 	bool res;	/** Status of insert, delete and search operations. */
+	bool merged;	/** true when insert added the mask to the node with equal base instead of linking the new node. */
+	UpdateJournal* journal; /** Journal that records successful add and del operations. Can be null pointer. */
+#ifdef ADDRESSTABLE_COMPACT_NODES
+	char* pool;				/** Address range reserved for nodes of this table, null pointer when table has no nodes. */
+	std::size_t committed;	/** Bytes at the start of the pool that are accessible. */
+	std::size_t next;		/** Index of the first never used slot, slot 0 is not used. */
+	std::size_t freeList;	/** Index of the first freed slot, 0 if there is none. */
+	std::size_t live;		/** Number of allocated nodes. */
+#endif
+	/**
+	 * @brief Internal function that allocates and constructs a node.
+	 * @param [in] b Base value of the IP prefix.
+	 * @param [in] m Mask value of the IP prefix.
+	 * @return Returns pointer to the new node.
+	 */
+	Node* newNode(unsigned int b, char m);
+	/**
+	 * @brief Internal function that releases a single node. Its children are not released.
+	 * @param [in] n Node that is released.
+	 */
+	void freeNode(Node* n);
+	/**
+	 * @brief Internal function that releases all nodes of the table.
+	 */
+	void destroy();
+	/**
+	 * @brief Internal function that collects prefixes stored in the subtree.
+	 * @param [in] root Root node of the subtree.
+	 * @param [out] out Vector that receives base and mask of every prefix.
+	 */
+	void collect(Node* root, std::vector<std::pair<unsigned int, char>>& out);
+	/**
+	 * @brief Internal function that builds balanced subtree from the sorted nodes.
+	 * @param [in] nodes Base and mask bits of the nodes ordered by base.
+	 * @param [in] lo Index of the first node of the subtree.
+	 * @param [in] hi Index after the last node of the subtree.
+	 * @return Returns root node of the subtree. Can return null pointer.
+	 */
+	Node* buildNode(const std::vector<std::pair<unsigned int, unsigned int>>& nodes, std::size_t lo, std::size_t hi);
 public:
+	/**
+	 * @brief Memory used by the table in bytes.
+	 */
+	struct MemoryUsage {
+		std::size_t nodes;			/** Number of nodes in the tree. */
+		std::size_t nodeBytes;		/** Bytes used by the node objects. */
+		std::size_t allocatorBytes;	/** Allocator overhead: malloc chunk headers and padding, or accessible pool bytes that don't hold nodes. */
+		std::size_t auxiliaryBytes;	/** Table object. */
+		std::size_t total;			/** Sum of all above. */
+	};
 	/**
 	 * @brief Constructor that will initialize the object.
 	 */
@@ -167,6 +275,44 @@ public:
 	 * @return True if convertion was successful, false otherwise.
 	 */
 	bool string2ip(std::string s, unsigned int* ip, char* mask);
+	/**
+	 * @brief Attaches journal that will record every successful add and del operation.
+	 * @param [in] j Pointer to the opened journal, null pointer detaches current journal.
+	 */
+	void setJournal(UpdateJournal* j);
+	/**
+	 * @brief Returns journal attached to the table.
+	 * @return Pointer to the journal or null pointer if there is none.
+	 */
+	UpdateJournal* getJournal();
+	/**
+	 * @brief Informs whether the table holds any prefix.
+	 * @return Returns true if no prefix was added, including /0.
+	 */
+	bool isEmpty();
+	/**
+	 * @brief Returns all prefixes stored in the table.
+	 * @param [out] out Vector that receives base and mask of every prefix, ordered by base value.
+	 */
+	void prefixes(std::vector<std::pair<unsigned int, char>>& out);
+	/**
+	 * @brief Replaces content of the table with prefixes from the sorted list. Tree is built directly in linear time.
+	 * @param [in] sorted Base and mask of every prefix, ordered by base value with applied mask as returned by prefixes().
+	 * @return Returns 0 for success, -1 for failure - list isn't sorted, holds the same prefix twice or mask is outside 0-32 range. Table is not changed on failure.
+	 */
+	int build(const std::vector<std::pair<unsigned int, char>>& sorted);
+	/**
+	 * @brief Reports memory used by the table.
+	 * @return Returns breakdown of bytes used by nodes, allocator and auxiliary structures.
+	 */
+	MemoryUsage memoryUsage();
+private:
+	/**
+	 * @brief Internal function that adds memory used by nodes of the subtree to the report.
+	 * @param [in] root Root node of the subtree.
+	 * @param [out] usage Report that is updated.
+	 */
+	void account(Node* root, MemoryUsage& usage);
 };
 
 #endif /* ADDRESSTABLE_H_ */
@@ -0,0 +1,511 @@
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#include "BulkLoader.h"
+#include "AddressTable.h"
+
+//IORING_OP_READ is an enum value, IORING_FEAT_RW_CUR_POS comes with it in Linux 5.6 headers
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BULKLOADER_URING
+#endif
+
+#ifdef BULKLOADER_URING
+//minimal io_uring used through raw system calls, only reads are submitted
+struct BulkLoader::Ring {
+	int fd;						/** Descriptor of the io_uring instance. */
+	unsigned char* sq;			/** Mapped submission ring. */
+	std::size_t sqSize;			/** Size of the submission ring mapping. */
+	unsigned char* cq;			/** Mapped completion ring, same as sq when kernel maps both at once. */
+	std::size_t cqSize;			/** Size of the completion ring mapping. */
+	io_uring_sqe* sqes;			/** Mapped submission entries. */
+	std::size_t sqesSize;		/** Size of the submission entries mapping. */
+	unsigned *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	io_uring_cqe* cqes;
+	unsigned int queued;		/** Entries added to the ring but not submitted yet. */
+
+	Ring():fd(-1), sq(nullptr), sqSize(0), cq(nullptr), cqSize(0), sqes(nullptr), sqesSize(0), sqTail(nullptr), sqMask(nullptr),
+			sqArray(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr), queued(0){
+	}
+
+	~Ring(){
+		if( nullptr != sqes )
+			munmap(sqes, sqesSize);
+		if( nullptr != cq && cq != sq )
+			munmap(cq, cqSize);
+		if( nullptr != sq )
+			munmap(sq, sqSize);
+		if( fd >= 0 )
+			::close(fd);
+	}
+
+	//returns null pointer when io_uring is not supported or not allowed
+	static Ring* create(unsigned int entries){
+		io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		int fd = syscall(__NR_io_uring_setup, entries, &p);
+		if( fd < 0 )
+			return nullptr;
+
+		Ring* r = new Ring();
+		r->fd = fd;
+		r->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		r->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		if( single )
+			r->sqSize = r->cqSize = (r->sqSize > r->cqSize) ? r->sqSize : r->cqSize;
+
+		void* m = mmap(nullptr, r->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if( MAP_FAILED == m ){
+			delete r;
+			return nullptr;
+		}
+		r->sq = static_cast<unsigned char*>(m);
+		if( single )
+			r->cq = r->sq;
+		else{
+			m = mmap(nullptr, r->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if( MAP_FAILED == m ){
+				delete r;
+				return nullptr;
+			}
+			r->cq = static_cast<unsigned char*>(m);
+		}
+		r->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+		m = mmap(nullptr, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if( MAP_FAILED == m ){
+			delete r;
+			return nullptr;
+		}
+		r->sqes = static_cast<io_uring_sqe*>(m);
+
+		r->sqTail = reinterpret_cast<unsigned*>(r->sq + p.sq_off.tail);
+		r->sqMask = reinterpret_cast<unsigned*>(r->sq + p.sq_off.ring_mask);
+		r->sqArray = reinterpret_cast<unsigned*>(r->sq + p.sq_off.array);
+		r->cqHead = reinterpret_cast<unsigned*>(r->cq + p.cq_off.head);
+		r->cqTail = reinterpret_cast<unsigned*>(r->cq + p.cq_off.tail);
+		r->cqMask = reinterpret_cast<unsigned*>(r->cq + p.cq_off.ring_mask);
+		r->cqes = reinterpret_cast<io_uring_cqe*>(r->cq + p.cq_off.cqes);
+		return r;
+	}
+
+	//adds read to the submission ring, it is passed to the kernel by submit()
+	void read(int file, char* buf, unsigned int len, unsigned long long off, unsigned long long data){
+		unsigned int tail = *sqTail;
+		unsigned int idx = tail & *sqMask;
+		io_uring_sqe* e = &sqes[idx];
+		memset(e, 0, sizeof(*e));
+		e->opcode = IORING_OP_READ;
+		e->fd = file;
+		e->addr = reinterpret_cast<unsigned long long>(buf);
+		e->len = len;
+		e->off = off;
+		e->user_data = data;
+		sqArray[idx] = idx;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		queued++;
+	}
+
+	//submits queued reads, when wait is true blocks until at least one read completes
+	int submit(bool wait){
+		int r;
+		do{
+			r = syscall(__NR_io_uring_enter, fd, queued, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		}while( r < 0 && errno == EINTR );
+		if( r > 0 )
+			queued -= r;
+		return r;
+	}
+
+	//removes reads that the kernel didn't take yet, without SQPOLL kernel reads the ring only in io_uring_enter
+	void withdraw(){
+		__atomic_store_n(sqTail, *sqTail - queued, __ATOMIC_RELEASE);
+		queued = 0;
+	}
+
+	//takes one completion from the ring
+	bool reap(unsigned long long* data, int* res){
+		unsigned int head = *cqHead;
+		if( head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) )
+			return false;
+		io_uring_cqe* e = &cqes[head & *cqMask];
+		*data = e->user_data;
+		*res = e->res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+#else
+//without io_uring headers only pread is compiled, ring is never created
+struct BulkLoader::Ring {
+	static Ring* create(unsigned int){ return nullptr; }
+	void read(int, char*, unsigned int, unsigned long long, unsigned long long){}
+	int submit(bool){ return -1; }
+	void withdraw(){}
+	bool reap(unsigned long long*, int*){ return false; }
+};
+#endif
+
+//reads until len bytes are read or end of file is reached
+static long preadAll(int fd, char* buf, std::size_t len, off_t off){
+	std::size_t got = 0;
+	while( got < len ){
+		ssize_t r = pread(fd, buf + got, len - got, off + got);
+		if( r < 0 ){
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+		if( r == 0 )
+			break;
+		got += r;
+	}
+	return got;
+}
+
+BulkLoader::BulkLoader(unsigned int depth, std::size_t chunk, unsigned int workers):depth(depth?depth:1), chunk(chunk?chunk:4096),
+		ring(nullptr), stopping(false){
+	unsigned int n = workers ? workers : std::thread::hardware_concurrency();
+	if( 0 == n )
+		n = 1;
+
+	//every buffer has at most one read in flight
+	unsigned int entries = 1;
+	while( entries < this->depth + n )
+		entries <<= 1;
+	ring = Ring::create(entries);
+
+	for(unsigned int i=0; i<n; i++)
+		this->workers.push_back(std::thread(&BulkLoader::workLoop, this));
+}
+
+BulkLoader::~BulkLoader(){
+	{
+		std::lock_guard<std::mutex> g(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(std::thread& t : workers)
+		t.join();
+	delete ring;
+}
+
+bool BulkLoader::usingUring(){
+	return nullptr != ring;
+}
+
+long BulkLoader::loadPrefixes(const std::string& file, AddressTable& at){
+	return run(file, at, false, nullptr);
+}
+
+long BulkLoader::checkAddresses(const std::string& file, AddressTable& at, std::vector<char>& masks){
+	masks.clear();
+	return run(file, at, true, &masks);
+}
+
+void BulkLoader::workLoop(){
+	std::unique_lock<std::mutex> g(lock);
+	while( true ){
+		wake.wait(g, [&]{ return stopping || !queue.empty(); });
+		if( queue.empty() )
+			break;
+		Job* job = queue.front();
+		queue.pop_front();
+		g.unlock();
+
+		parse(job);
+
+		g.lock();
+		job->done = true;
+		finished.notify_all();
+	}
+}
+
+bool BulkLoader::parseLine(const char* p, const char* e, unsigned int* ip, char* mask){
+	unsigned int a = 0;
+	for(int i=0; i<4; i++){
+		const char* s = p;
+		unsigned int v = 0;
+		while( p < e && p - s < 3 && *p >= '0' && *p <= '9' )
+			v = v*10 + (*p++ - '0');
+		if( p == s || v > 255 )
+			return false;
+		a = (a << 8) | v;
+		if( i < 3 ){
+			if( p == e || *p != '.' )
+				return false;
+			p++;
+		}
+	}
+	if( nullptr != mask ){
+		if( p == e || *p != '/' )
+			return false;
+		p++;
+		const char* s = p;
+		unsigned int v = 0;
+		while( p < e && p - s < 2 && *p >= '0' && *p <= '9' )
+			v = v*10 + (*p++ - '0');
+		if( p == s || v > 32 )
+			return false;
+		*mask = (char)v;
+	}
+	if( p != e )
+		return false;
+	*ip = a;
+	return true;
+}
+
+void BulkLoader::parse(BulkLoader::Job* job){
+	const char* p = job->begin;
+	while( p < job->end ){
+		const char* nl = static_cast<const char*>(memchr(p, '\n', job->end - p));
+		const char* e = nl ? nl : job->end;
+		const char* le = e;
+		if( le > p && le[-1] == '\r' )
+			le--;
+		//empty lines are skipped
+		if( le > p ){
+			unsigned int ip;
+			char mask;
+			if( nullptr != job->at )
+				job->masks.push_back(parseLine(p, le, &ip, nullptr) ? job->at->check(ip) : -1);
+			else if( parseLine(p, le, &ip, &mask) ){
+				job->ips.push_back(ip);
+				job->masks.push_back(mask);
+			}
+		}
+		p = e + 1;
+	}
+}
+
+long BulkLoader::run(const std::string& file, AddressTable& at, bool lookup, std::vector<char>* masks){
+	int fd = ::open(file.c_str(), O_RDONLY);
+	if( fd < 0 )
+		return -1;
+	struct stat st;
+	if( fstat(fd, &st) != 0 ){
+		::close(fd);
+		return -1;
+	}
+	std::size_t size = st.st_size;
+	std::size_t chunks = (size + chunk - 1) / chunk;
+
+	//depth buffers are being read while each worker parses one more, chunk k always uses buffer k % count
+	std::size_t count = depth + workers.size();
+	if( count > chunks )
+		count = chunks;
+	std::vector<std::vector<char>> buffers(count);
+	std::vector<long> got(count, 0);
+	std::vector<char> ready(count, false);
+	std::vector<Job> jobs(count);
+	std::deque<std::size_t> unsubmitted;
+	unsigned int inflight = 0;
+	bool uring = nullptr != ring;
+	bool failed = false;
+
+	auto length = [&](std::size_t k){
+		return (k + 1 < chunks) ? chunk : size - k * chunk;
+	};
+	auto issue = [&](std::size_t k){
+		std::size_t b = k % count;
+		if( buffers[b].empty() )
+			buffers[b].resize(SLACK + chunk);
+		ready[b] = false;
+		if( uring ){
+			unsubmitted.push_back(k);
+			ring->read(fd, buffers[b].data() + SLACK, length(k), k * chunk, b);
+			inflight++;
+		}
+		else{
+			got[b] = preadAll(fd, buffers[b].data() + SLACK, length(k), k * chunk);
+			ready[b] = true;
+		}
+	};
+	//reads refused by the kernel (e.g. EAGAIN, EBUSY) are done with pread, rest of the file is read the same way
+	auto submit = [&](bool wait){
+		int r = ring->submit(wait);
+		if( r < 0 ){
+			ring->withdraw();
+			for(std::size_t k : unsubmitted){
+				std::size_t b = k % count;
+				got[b] = preadAll(fd, buffers[b].data() + SLACK, length(k), k * chunk);
+				ready[b] = true;
+				inflight--;
+			}
+			unsubmitted.clear();
+			uring = false;
+			return false;
+		}
+		unsubmitted.erase(unsubmitted.begin(), unsubmitted.begin() + r);
+		return true;
+	};
+	//submitted reads are never abandoned because the kernel writes into the buffers until they complete
+	auto collect = [&](){
+		unsigned long long b;
+		int res;
+		bool any = false;
+		while( ring->reap(&b, &res) ){
+			got[b] = res;
+			ready[b] = true;
+			inflight--;
+			any = true;
+		}
+		//completions are posted even when waiting fails, so they are polled
+		if( !any && !submit(true) )
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	};
+
+	//empty table without journal is built at once from the sorted prefixes instead of inserting them one by one
+	bool bulk = !lookup && at.isEmpty() && nullptr == at.getJournal();
+	std::vector<std::pair<unsigned int, char>> sorted;
+
+	long result = 0;
+	std::size_t consumed = 0;
+	std::size_t dispatched = 0;
+	auto consume = [&](){
+		Job& job = jobs[consumed % count];
+		{
+			std::unique_lock<std::mutex> g(lock);
+			finished.wait(g, [&]{ return job.done; });
+		}
+		if( lookup ){
+			masks->insert(masks->end(), job.masks.begin(), job.masks.end());
+			result += job.masks.size();
+			if( job.overlong ){
+				masks->push_back(-1);
+				result++;
+			}
+		}
+		else if( bulk ){
+			for(std::size_t i=0; i<job.ips.size(); i++){
+				char m = job.masks[i];
+				sorted.push_back(std::make_pair(m ? job.ips[i] & (~0u << (32 - m)) : 0u, m));
+			}
+		}
+		else{
+			for(std::size_t i=0; i<job.ips.size(); i++)
+				if( 0 == at.add(job.ips[i], job.masks[i]) )
+					result++;
+		}
+		//buffer is free, start reading next chunk into it
+		if( !failed && consumed + count < chunks ){
+			issue(consumed + count);
+			if( uring )
+				submit(false);
+		}
+		consumed++;
+	};
+
+	std::string carry;
+	bool skip = false;
+	try{
+		for(std::size_t k=0; k<count; k++)
+			issue(k);
+		if( uring && count )
+			submit(false);
+
+		for(std::size_t k=0; k<chunks && !failed; k++){
+			std::size_t b = k % count;
+			std::size_t len = length(k);
+			while( !ready[b] )
+				collect();
+			//short or failed read is completed synchronously
+			if( got[b] < (long)len ){
+				long done = got[b] > 0 ? got[b] : 0;
+				long r = preadAll(fd, buffers[b].data() + SLACK + done, len - done, k * chunk + done);
+				if( r != (long)(len - done) ){
+					failed = true;
+					break;
+				}
+			}
+
+			char* data = buffers[b].data() + SLACK;
+			char* end = data + len;
+			char* begin = data;
+			if( skip ){
+				//rest of the line that didn't fit into the carry
+				char* nl = static_cast<char*>(memchr(data, '\n', len));
+				begin = nl ? nl + 1 : end;
+				skip = (nullptr == nl);
+			}
+			else if( !carry.empty() ){
+				begin = data - carry.size();
+				memcpy(begin, carry.data(), carry.size());
+				carry.clear();
+			}
+
+			//incomplete last line is carried to the next chunk, line too long for the carry is reported after this job as malformed
+			char* last = end;
+			bool overlong = false;
+			if( k + 1 < chunks && begin < end ){
+				char* nl = static_cast<char*>(memrchr(begin, '\n', end - begin));
+				last = nl ? nl + 1 : begin;
+				if( (std::size_t)(end - last) <= SLACK )
+					carry.assign(last, end);
+				else
+					skip = overlong = true;
+			}
+
+			Job& job = jobs[b];
+			job.begin = begin;
+			job.end = last;
+			job.overlong = overlong;
+			job.at = lookup ? &at : nullptr;
+			job.ips.clear();
+			job.masks.clear();
+			job.done = false;
+			{
+				std::lock_guard<std::mutex> g(lock);
+				queue.push_back(&job);
+			}
+			wake.notify_one();
+			dispatched++;
+
+			//keep one job per worker so buffers return for new reads
+			while( dispatched - consumed > workers.size() )
+				consume();
+		}
+
+		//wait for jobs that still use the buffers
+		while( consumed < dispatched )
+			consume();
+	}
+	catch(...){
+		//e.g. std::bad_alloc from the table, results are dropped but workers and reads must not outlive the buffers
+		{
+			std::unique_lock<std::mutex> g(lock);
+			for( ; consumed < dispatched; consumed++ ){
+				Job& job = jobs[consumed % count];
+				finished.wait(g, [&]{ return job.done; });
+			}
+		}
+		while( inflight > 0 )
+			collect();
+		::close(fd);
+		throw;
+	}
+	while( inflight > 0 )
+		collect();
+	::close(fd);
+
+	if( bulk && !failed ){
+		//prefixes listed more than once are added once, same as with add()
+		std::sort(sorted.begin(), sorted.end());
+		sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+		if( at.build(sorted) != 0 )
+			return -1;
+		result = sorted.size();
+	}
+	return failed ? -1 : result;
+}
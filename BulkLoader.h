@@ -0,0 +1,119 @@
+#ifndef BULKLOADER_H_
+#define BULKLOADER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+class AddressTable;
+
+/**
+ * Class that loads large files with IP prefixes or addresses into the AddressTable.
+ *
+ * File is read in large chunks with several reads kept in flight using io_uring, or with plain pread when io_uring is not available.
+ * Completed chunks are parsed by worker threads while the next reads are pending. Parsed prefixes are added to the table in the
+ * order of the file, parsed addresses are checked against the table directly by the workers.
+ */
+class BulkLoader {
+public:
+	/**
+	 * @brief Constructor that starts worker threads.
+	 * @param [in] depth Number of reads kept in flight.
+	 * @param [in] chunk Size of a single read in bytes.
+	 * @param [in] workers Number of parsing threads, 0 selects number of available CPUs.
+	 */
+	BulkLoader(unsigned int depth = 4, std::size_t chunk = 4 << 20, unsigned int workers = 0);
+	/**
+	 * @brief Destructor that stops worker threads and releases io_uring.
+	 */
+	virtual ~BulkLoader();
+	/**
+	 * @brief Adds all prefixes from the file to the table. File holds one prefix in IPv4 CIDR notation per line.
+	 * @param [in] file Name of the file.
+	 * @param [in] at Table that receives prefixes.
+	 * @return Returns number of prefixes added to the table, -1 for failure - file couldn't be read.
+	 * @note Malformed lines and prefixes rejected by AddressTable::add are skipped. When the table is empty and has no journal, prefixes
+	 * are collected, sorted once and the tree is built with AddressTable::build, otherwise every prefix is inserted with AddressTable::add.
+	 */
+	long loadPrefixes(const std::string& file, AddressTable& at);
+	/**
+	 * @brief Checks all addresses from the file against the table. File holds one IPv4 address per line.
+	 * @param [in] file Name of the file.
+	 * @param [in] at Table that is searched. It must not be modified until function returns.
+	 * @param [out] masks Vector that receives result of AddressTable::check for every non-empty line of the file in the file order, -1 for malformed lines including lines too long to hold an address.
+	 * @return Returns number of checked lines, -1 for failure - file couldn't be read.
+	 */
+	long checkAddresses(const std::string& file, AddressTable& at, std::vector<char>& masks);
+	/**
+	 * @brief Informs whether reads are done with io_uring.
+	 * @return Returns true if io_uring is used, false if reads fall back to pread.
+	 */
+	bool usingUring();
+
+private:
+	/**
+	 * @brief io_uring instance, defined only in the source file.
+	 */
+	struct Ring;
+
+	/**
+	 * @brief Part of the file that is parsed by a worker.
+	 */
+	struct Job {
+		const char* begin;		/** First byte of the first complete line. */
+		const char* end;		/** Byte after the last complete line. */
+		bool overlong;			/** true when line that starts after the end is too long to be carried to the next chunk. */
+		AddressTable* at;		/** Table searched for addresses, null pointer when prefixes are parsed. */
+		std::vector<unsigned int> ips;	/** Parsed prefix bases. */
+		std::vector<char> masks;	/** Parsed prefix masks or results of the address checks. */
+		bool done;				/** true when worker finished the job. */
+	};
+
+	/**
+	 * @brief Number of bytes in front of every buffer reserved for the part of the line carried from previous chunk.
+	 */
+	static const std::size_t SLACK = 64;
+
+	unsigned int depth;			/** Number of reads kept in flight. */
+	std::size_t chunk;			/** Size of a single read. */
+	Ring* ring;					/** io_uring instance, null pointer when pread is used. */
+	std::vector<std::thread> workers;	/** Parsing threads. */
+	std::deque<Job*> queue;		/** Jobs waiting for a worker. */
+	std::mutex lock;			/** Guards the queue and done flags of the jobs. */
+	std::condition_variable wake;	/** Wakes workers when job is queued. */
+	std::condition_variable finished;	/** Signals that job is done. */
+	bool stopping;				/** true when workers should finish. */
+
+	/**
+	 * @brief Main loop of the worker thread.
+	 */
+	void workLoop();
+	/**
+	 * @brief Parses lines of the job and checks addresses if the job has a table.
+	 */
+	static void parse(Job* job);
+	/**
+	 * @brief Reads the file and passes results of parsed chunks in the file order to the table or output vector.
+	 * @param [in] file Name of the file.
+	 * @param [in] at Table that is searched when lookup is true, or receives prefixes otherwise.
+	 * @param [in] lookup true when file holds addresses that are checked.
+	 * @param [out] masks Results of the checks when lookup is true.
+	 * @return Returns number of added prefixes or checked addresses, -1 for failure.
+	 */
+	long run(const std::string& file, AddressTable& at, bool lookup, std::vector<char>* masks);
+	/**
+	 * @brief Parses single line with IP address and optional mask.
+	 * @param [in] p First character of the line.
+	 * @param [in] e Character after the end of the line.
+	 * @param [out] ip Parsed address.
+	 * @param [out] mask Parsed mask. If this parameter is null then line must hold only an address.
+	 * @return Returns true if line is well formed.
+	 */
+	static bool parseLine(const char* p, const char* e, unsigned int* ip, char* mask);
+};
+
+#endif /* BULKLOADER_H_ */
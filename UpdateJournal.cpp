@@ -0,0 +1,389 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include "UpdateJournal.h"
+#include "AddressTable.h"
+
+//snapshot header: magic, version, number of the first log not included in the snapshot, number of records
+static const char SNAP_MAGIC[4] = {'I','P','S','N'};
+static const unsigned int SNAP_VERSION = 1;
+static const unsigned int SNAP_HEADER = 16;
+
+static void put32(char* p, unsigned int v){
+	for(int i=0; i<4; i++)
+		p[i] = (char)(v >> (8*i));
+}
+
+static unsigned int get32(const char* p){
+	unsigned int v = 0;
+	for(int i=0; i<4; i++)
+		v |= ((unsigned int)(unsigned char)p[i]) << (8*i);
+	return v;
+}
+
+UpdateJournal::UpdateJournal(std::string path, unsigned int batch, unsigned int interval):path(path), batch(batch?batch:1), interval(interval),
+		gen(0), snapGen(0), fd(-1), stopping(false), failed(false), checkpointResult(0), waiting(0), appended(0), durable(0){
+}
+
+UpdateJournal::~UpdateJournal(){
+	close();
+	waitCheckpoint();
+}
+
+std::string UpdateJournal::logName(unsigned int g){
+	return path + ".log." + std::to_string(g);
+}
+
+//record layout: operation, mask, base in little endian, 16 bit check value
+void UpdateJournal::encode(char* r, Operation op, unsigned int base, char mask){
+	r[0] = (char)op;
+	r[1] = mask;
+	put32(r+2, base);
+	unsigned int sum = 0;
+	for(int i=0; i<6; i++)
+		sum += (i+1) * (unsigned char)r[i];
+	//constant makes zero filled tail of the file invalid
+	sum ^= 0x5A5A;
+	r[6] = (char)sum;
+	r[7] = (char)(sum >> 8);
+}
+
+bool UpdateJournal::decode(const char* r, Operation* op, unsigned int* base, char* mask){
+	unsigned int sum = 0;
+	for(int i=0; i<6; i++)
+		sum += (i+1) * (unsigned char)r[i];
+	sum ^= 0x5A5A;
+	if( (unsigned char)r[6] != (sum & 0xFF) || (unsigned char)r[7] != ((sum >> 8) & 0xFF) )
+		return false;
+	if( (r[0] != ADD && r[0] != DEL) || r[1] < 0 || r[1] > 32 )
+		return false;
+	*op = (Operation)r[0];
+	*mask = r[1];
+	*base = get32(r+2);
+	return true;
+}
+
+bool UpdateJournal::writeAll(int fd, const char* data, size_t size){
+	while( size > 0 ){
+		ssize_t w = ::write(fd, data, size);
+		if( w < 0 ){
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+		data += w;
+		size -= w;
+	}
+	return true;
+}
+
+int UpdateJournal::replay(const std::string& name, AddressTable& at, bool truncate){
+	int f = ::open(name.c_str(), truncate ? O_RDWR : O_RDONLY);
+	if( f < 0 )
+		return (errno == ENOENT) ? -2 : -1;
+
+	std::vector<char> buf(RECORD * 65536);
+	size_t used = 0;
+	long valid = 0;
+	int n = 0;
+	bool torn = false;
+
+	while( !torn ){
+		ssize_t r = ::read(f, buf.data() + used, buf.size() - used);
+		if( r < 0 ){
+			if( errno == EINTR )
+				continue;
+			::close(f);
+			return -1;
+		}
+		if( r == 0 )
+			break;
+		used += r;
+
+		//apply all complete records, partial one is moved to the front of the buffer
+		size_t pos = 0;
+		for( ; pos + RECORD <= used; pos += RECORD ){
+			Operation op;
+			unsigned int base;
+			char mask;
+			if( !decode(buf.data() + pos, &op, &base, &mask) ){
+				torn = true;
+				break;
+			}
+			if( op == ADD )
+				at.add(base, mask);
+			else
+				at.del(base, mask);
+			valid += RECORD;
+			++n;
+		}
+		if( !torn ){
+			memmove(buf.data(), buf.data() + pos, used - pos);
+			used -= pos;
+		}
+	}
+	//anything after last valid record was left by the crash in the middle of the write, only the last log can have it
+	if( (torn || used) && (!truncate || ftruncate(f, valid) != 0) ){
+		::close(f);
+		return -1;
+	}
+	::close(f);
+	return n;
+}
+
+int UpdateJournal::loadSnapshot(AddressTable& at){
+	std::string snap = path + ".snap";
+	int f = ::open(snap.c_str(), O_RDONLY);
+	if( f < 0 )
+		return (errno == ENOENT) ? -2 : -1;
+
+	std::vector<char> buf;
+	char block[65536];
+	while( true ){
+		ssize_t r = ::read(f, block, sizeof(block));
+		if( r < 0 ){
+			if( errno == EINTR )
+				continue;
+			::close(f);
+			return -1;
+		}
+		if( r == 0 )
+			break;
+		buf.insert(buf.end(), block, block + r);
+	}
+	::close(f);
+
+	if( buf.size() < SNAP_HEADER || memcmp(buf.data(), SNAP_MAGIC, 4) != 0 || get32(buf.data()+4) != SNAP_VERSION )
+		return -1;
+	std::size_t count = get32(buf.data()+12);
+	if( buf.size() != SNAP_HEADER + count * RECORD )
+		return -1;
+
+	//snapshot is sorted by base, so the tree is built directly instead of adding prefixes one by one
+	std::vector<std::pair<unsigned int, char>> prefixes(count);
+	for(std::size_t i=0; i<count; i++){
+		Operation op;
+		if( !decode(buf.data() + SNAP_HEADER + i * RECORD, &op, &prefixes[i].first, &prefixes[i].second) || op != ADD )
+			return -1;
+	}
+	if( at.build(prefixes) != 0 )
+		return -1;
+
+	gen = snapGen = get32(buf.data()+8);
+	return 0;
+}
+
+int UpdateJournal::syncDirectory(){
+	size_t slash = path.find_last_of('/');
+	std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash+1);
+	int d = ::open(dir.c_str(), O_RDONLY);
+	if( d < 0 )
+		return -1;
+	int r = fsync(d);
+	::close(d);
+	return (r == 0) ? 0 : -1;
+}
+
+int UpdateJournal::recover(AddressTable& at){
+	//records replayed to the table shouldn't be journaled again
+	UpdateJournal* attached = at.getJournal();
+	at.setJournal(nullptr);
+
+	int result = 0;
+	gen = snapGen = 0;
+
+	//load snapshot if there is one
+	if( loadSnapshot(at) == -1 ){
+		at.setJournal(attached);
+		return -1;
+	}
+
+	//replay log files written after the snapshot, only the last one can have torn record
+	for(unsigned int g = snapGen; ; ++g){
+		bool last = (access(logName(g+1).c_str(), F_OK) != 0);
+		int n = replay(logName(g), at, last);
+		if( n == -2 )
+			break;
+		if( n < 0 ){
+			result = -1;
+			break;
+		}
+		result += n;
+		gen = g;
+		if( last )
+			break;
+	}
+
+	//remove logs left by the checkpoint that was interrupted after the snapshot was stored
+	for(unsigned int g = snapGen; g > 0 && unlink(logName(g-1).c_str()) == 0; --g);
+
+	at.setJournal(attached);
+	return result;
+}
+
+int UpdateJournal::open(){
+	if( fd >= 0 )
+		return 0;
+	fd = ::open(logName(gen).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if( fd < 0 )
+		return -1;
+	//records in the log are durable only when its directory entry is
+	if( syncDirectory() != 0 ){
+		::close(fd);
+		fd = -1;
+		return -1;
+	}
+	stopping = false;
+	failed = false;
+	writer = std::thread(&UpdateJournal::writeLoop, this);
+	return 0;
+}
+
+void UpdateJournal::close(){
+	if( fd < 0 )
+		return;
+	{
+		std::lock_guard<std::mutex> g(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+	::close(fd);
+	fd = -1;
+}
+
+void UpdateJournal::append(Operation op, unsigned int base, char mask){
+	std::lock_guard<std::mutex> g(lock);
+	size_t s = pending.size();
+	pending.resize(s + RECORD);
+	encode(pending.data() + s, op, base, mask);
+	++appended;
+	if( 0 == s || pending.size() >= batch * RECORD )
+		wake.notify_one();
+}
+
+int UpdateJournal::sync(){
+	std::unique_lock<std::mutex> g(lock);
+	if( fd < 0 )
+		return -1;
+	unsigned long long target = appended;
+	++waiting;
+	wake.notify_one();
+	done.wait(g, [&]{ return durable >= target || failed; });
+	--waiting;
+	return failed ? -1 : 0;
+}
+
+//group commit: all records collected since the last write are written and synchronized together
+void UpdateJournal::writeLoop(){
+	std::vector<char> out;
+	std::unique_lock<std::mutex> g(lock);
+	while( true ){
+		//sleep until the first record is buffered, then give the batch interval to fill up
+		wake.wait(g, [&]{ return stopping || !pending.empty(); });
+		if( !pending.empty() )
+			wake.wait_for(g, std::chrono::milliseconds(interval), [&]{
+				return stopping || waiting || pending.size() >= batch * RECORD; });
+		if( pending.empty() ){
+			if( stopping )
+				break;
+			continue;
+		}
+		out.swap(pending);
+		unsigned long long target = appended;
+		g.unlock();
+
+		bool ok;
+		{
+			std::lock_guard<std::mutex> io(ioLock);
+			ok = writeAll(fd, out.data(), out.size()) && fdatasync(fd) == 0;
+		}
+		out.clear();
+
+		g.lock();
+		if( ok )
+			durable = target;
+		else
+			failed = true;
+		done.notify_all();
+	}
+}
+
+int UpdateJournal::checkpoint(AddressTable& at){
+	if( fd < 0 || sync() != 0 )
+		return -1;
+	waitCheckpoint();
+
+	//switch to the new log, records appended from now on are not part of the snapshot
+	int nfd = ::open(logName(gen+1).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if( nfd < 0 )
+		return -1;
+	if( syncDirectory() != 0 ){
+		::close(nfd);
+		unlink(logName(gen+1).c_str());
+		return -1;
+	}
+	{
+		std::lock_guard<std::mutex> g(lock);
+		std::lock_guard<std::mutex> io(ioLock);
+		::close(fd);
+		fd = nfd;
+		++gen;
+	}
+
+	std::vector<std::pair<unsigned int, char>> prefixes;
+	at.prefixes(prefixes);
+	compactor = std::thread([this](std::vector<std::pair<unsigned int, char>> p, unsigned int g){
+		checkpointResult = writeSnapshot(std::move(p), g);
+	}, std::move(prefixes), gen);
+	return 0;
+}
+
+int UpdateJournal::waitCheckpoint(){
+	if( compactor.joinable() )
+		compactor.join();
+	return checkpointResult;
+}
+
+int UpdateJournal::writeSnapshot(std::vector<std::pair<unsigned int, char>> prefixes, unsigned int g){
+	std::string snap = path + ".snap";
+	std::string tmp = snap + ".tmp";
+	int f = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if( f < 0 )
+		return -1;
+
+	std::vector<char> buf(SNAP_HEADER);
+	memcpy(buf.data(), SNAP_MAGIC, 4);
+	put32(buf.data()+4, SNAP_VERSION);
+	put32(buf.data()+8, g);
+	put32(buf.data()+12, prefixes.size());
+
+	bool ok = true;
+	for(size_t i=0; ok && i<prefixes.size(); i++){
+		size_t s = buf.size();
+		buf.resize(s + RECORD);
+		encode(buf.data() + s, ADD, prefixes[i].first, prefixes[i].second);
+		if( buf.size() >= RECORD * 65536 ){
+			ok = writeAll(f, buf.data(), buf.size());
+			buf.clear();
+		}
+	}
+	ok = ok && writeAll(f, buf.data(), buf.size()) && fdatasync(f) == 0;
+	::close(f);
+	if( !ok || rename(tmp.c_str(), snap.c_str()) != 0 ){
+		unlink(tmp.c_str());
+		return -1;
+	}
+
+	//make the rename durable before the logs are removed
+	if( syncDirectory() != 0 )
+		return -1;
+
+	for(unsigned int l = snapGen; l < g; l++)
+		unlink(logName(l).c_str());
+	snapGen = g;
+	return 0;
+}
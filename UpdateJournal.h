@@ -0,0 +1,156 @@
+#ifndef UPDATEJOURNAL_H_
+#define UPDATEJOURNAL_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class AddressTable;
+
+/**
+ * Class that keeps append-only binary journal of add and del operations applied to the AddressTable, so they can be recovered after a crash.
+ *
+ * Journal consists of a snapshot file (path.snap) and numbered log files (path.log.N). Records appended to the journal are buffered
+ * and written by a background thread in batches followed by a single fdatasync (group commit). Checkpoint starts a new log file and
+ * writes snapshot of the table in the background, after which older log files are removed.
+ */
+class UpdateJournal {
+public:
+	/**
+	 * @brief Type of the operation stored in the journal record.
+	 */
+	enum Operation : unsigned char { ADD = 'A', DEL = 'D' };
+
+	/**
+	 * @brief Constructor that only remembers journal location, no files are touched.
+	 * @param [in] path Path prefix for the snapshot and log files.
+	 * @param [in] batch Number of buffered records that triggers write to the log file.
+	 * @param [in] interval Maximum time in milliseconds that buffered records wait before they are written.
+	 */
+	UpdateJournal(std::string path, unsigned int batch = 4096, unsigned int interval = 2);
+	/**
+	 * @brief Destructor that writes all buffered records, waits for running checkpoint and closes the log file.
+	 */
+	virtual ~UpdateJournal();
+	/**
+	 * @brief Loads latest snapshot into the table and replays log files written after it.
+	 * @param [in] at Table that receives recovered prefixes. Snapshot replaces its content. Journal attached to the table is not updated during replay.
+	 * @return Returns number of replayed log records, -1 for failure - snapshot or log file couldn't be read or log other than the last one is corrupted.
+	 * @note Should be called before open(), torn record at the end of the last log file is truncated.
+	 */
+	int recover(AddressTable& at);
+	/**
+	 * @brief Opens current log file for appending and starts background thread that writes buffered records.
+	 * @return Returns 0 for success, -1 for failure - log file couldn't be opened.
+	 */
+	int open();
+	/**
+	 * @brief Closes the journal. Buffered records are written and synchronized before the log file is closed.
+	 */
+	void close();
+	/**
+	 * @brief Adds record to the write buffer. Function doesn't wait for the record to be written.
+	 * @param [in] op Type of the operation.
+	 * @param [in] base Base value of the IP prefix.
+	 * @param [in] mask Mask value of the IP prefix.
+	 */
+	void append(Operation op, unsigned int base, char mask);
+	/**
+	 * @brief Waits until all records appended so far are written and synchronized with the disk.
+	 * @return Returns 0 for success, -1 for failure - write or fdatasync of the log file failed.
+	 */
+	int sync();
+	/**
+	 * @brief Starts new log file and writes snapshot of the table in the background. Older log files are removed when snapshot is stored.
+	 * @param [in] at Table that is stored in the snapshot. Only copy of its prefixes is made in the calling thread.
+	 * @return Returns 0 when checkpoint was started, -1 for failure.
+	 * @note Waits for previous checkpoint if it is still running.
+	 */
+	int checkpoint(AddressTable& at);
+	/**
+	 * @brief Waits for the background part of the last checkpoint.
+	 * @return Returns 0 for success, -1 for failure - snapshot couldn't be written.
+	 */
+	int waitCheckpoint();
+
+private:
+	/**
+	 * @brief Size of the single record in the log and snapshot files.
+	 */
+	static const unsigned int RECORD = 8;
+
+	std::string path;			/** Path prefix for the journal files. */
+	unsigned int batch;			/** Number of records that triggers write. */
+	unsigned int interval;		/** Maximum delay of the write in milliseconds. */
+	unsigned int gen;			/** Number of the current log file. */
+	unsigned int snapGen;		/** Number of the first log file not included in the snapshot. */
+	int fd;						/** Descriptor of the current log file. */
+	bool stopping;				/** true when background writer should finish. */
+	bool failed;				/** true when write or sync of the log file failed. */
+	int checkpointResult;		/** Result of the last background checkpoint. */
+	unsigned int waiting;		/** Number of threads waiting in sync(). */
+	unsigned long long appended;	/** Number of records appended to the buffer. */
+	unsigned long long durable;		/** Number of records written and synchronized. */
+	std::vector<char> pending;	/** Records that weren't written yet. */
+	std::mutex lock;			/** Guards buffer, counters and flags. */
+	std::mutex ioLock;			/** Guards log file descriptor during write and switch of the log file. */
+	std::condition_variable wake;	/** Wakes background writer. */
+	std::condition_variable done;	/** Signals that records became durable. */
+	std::thread writer;			/** Background writer thread. */
+	std::thread compactor;		/** Background checkpoint thread. */
+
+	/**
+	 * @brief Main loop of the background writer.
+	 */
+	void writeLoop();
+	/**
+	 * @brief Writes snapshot file and removes log files included in it.
+	 * @param [in] prefixes Copy of the table's prefixes.
+	 * @param [in] g Number of the first log file not included in the snapshot.
+	 * @return Returns 0 for success, -1 for failure.
+	 */
+	int writeSnapshot(std::vector<std::pair<unsigned int, char>> prefixes, unsigned int g);
+	/**
+	 * @brief Builds the table from the snapshot file.
+	 * @param [in] at Table that receives prefixes.
+	 * @return Returns 0 for success, -1 for failure, -2 when snapshot doesn't exist.
+	 */
+	int loadSnapshot(AddressTable& at);
+	/**
+	 * @brief Synchronizes directory of the journal files, so created and renamed files survive a crash.
+	 * @return Returns 0 for success, -1 for failure.
+	 */
+	int syncDirectory();
+	/**
+	 * @brief Applies records from the file to the table.
+	 * @param [in] name Name of the file.
+	 * @param [in] at Table that receives records.
+	 * @param [in] truncate When true torn record at the end of the file is cut off, otherwise it is reported as failure.
+	 * @return Returns number of applied records, -1 for failure, -2 when file doesn't exist.
+	 */
+	int replay(const std::string& name, AddressTable& at, bool truncate);
+	/**
+	 * @brief Returns name of the log file with given number.
+	 */
+	std::string logName(unsigned int g);
+	/**
+	 * @brief Encodes operation into journal record.
+	 * @param [out] r Buffer with space for one record.
+	 */
+	static void encode(char* r, Operation op, unsigned int base, char mask);
+	/**
+	 * @brief Decodes journal record.
+	 * @return Returns true if record is valid, false if it is torn or corrupted.
+	 */
+	static bool decode(const char* r, Operation* op, unsigned int* base, char* mask);
+	/**
+	 * @brief Writes whole buffer to the file descriptor.
+	 * @return Returns true if all bytes were written.
+	 */
+	static bool writeAll(int fd, const char* data, size_t size);
+};
+
+#endif /* UPDATEJOURNAL_H_ */
@@ -7,6 +7,8 @@
 #include <cstdlib>
 
 #include "AddressTable.h"
+#include "UpdateJournal.h"
+#include "BulkLoader.h"
 
 std::string ip2string(unsigned int ip){
 	return std::to_string((ip&0xFF000000)>>24)+"."+std::to_string((ip&0x00FF0000)>>16)+"."+
@@ -80,5 +82,90 @@ int main(void) {
 
 	std::cout<<"searching for mask for IP: "<<ip2string(ip)<<" result:"<<(int)at.check(ip)<<std::endl;
 
+	std::cout<<std::endl<<"memory usage and lookup benchmark"<<std::endl;
+	AddressTable::MemoryUsage mu = at.memoryUsage();
+	std::cout<<"nodes: "<<mu.nodes<<" node bytes: "<<mu.nodeBytes<<" allocator bytes: "<<mu.allocatorBytes<<
+			" auxiliary bytes: "<<mu.auxiliaryBytes<<" total: "<<mu.total<<std::endl;
+	{
+		int lookups = 10000;
+		std::vector<unsigned int> addresses(lookups);
+		for(int i=0; i<lookups; ++i)
+			addresses[i] = (rand()%256)+((rand()%256)<<8)+((rand()%256)<<16)+((rand()%256)<<24);
+
+		int found = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(int i=0; i<lookups; ++i)
+			found += (at.check(addresses[i]) >= 0);
+		auto end = std::chrono::steady_clock::now();
+		std::cout<<lookups<<" lookups in "<<std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count()<<" ms, found: "<<found<<std::endl;
+	}
+
+	std::cout<<std::endl<<"test for bulk loading of prefixes and addresses"<<std::endl;
+	{
+		//small chunks so lines are split between reads
+		BulkLoader loader(4, 1 << 16);
+		std::cout<<"using io_uring: "<<loader.usingUring()<<std::endl;
+
+		AddressTable bt;
+		auto start = std::chrono::steady_clock::now();
+		long loaded = loader.loadPrefixes("prefs.txt", bt);
+		auto end = std::chrono::steady_clock::now();
+		std::cout<<"loaded "<<loaded<<" prefixes in "<<std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count()<<" ms"<<std::endl;
+		std::vector<std::pair<unsigned int, char>> a,b;
+		at.prefixes(a);
+		bt.prefixes(b);
+		std::cout<<"bulk loaded table matches: "<<(a == b)<<std::endl;
+
+		int checks = 1000;
+		std::vector<unsigned int> addresses(checks);
+		std::ofstream addrs;
+		addrs.open ("addrs.txt");
+		for(int i=0; i<checks; ++i){
+			addresses[i] = (rand()%256)+((rand()%256)<<8)+((rand()%256)<<16)+((rand()%256)<<24);
+			addrs<<ip2string(addresses[i])<<"\n";
+		}
+		addrs.close();
+
+		std::vector<char> masks;
+		std::cout<<"checked addresses: "<<loader.checkAddresses("addrs.txt", bt, masks)<<std::endl;
+		int same = 0;
+		for(int i=0; i<checks && i<(int)masks.size(); ++i)
+			same += (masks[i] == bt.check(addresses[i]));
+		std::cout<<"matching results: "<<same<<std::endl;
+	}
+
+	std::cout<<std::endl<<"test for journal recovery"<<std::endl;
+	{
+		AddressTable jt;
+		UpdateJournal journal("journal");
+		std::cout<<"replayed records: "<<journal.recover(jt)<<std::endl;
+		journal.open();
+		jt.setJournal(&journal);
+
+		//journal random prefixes, checkpoint in the middle of the updates
+		auto start = std::chrono::steady_clock::now();
+		for(int i=0; i<ips; ++i){
+			ip = (rand()%256)+((rand()%256)<<8)+((rand()%256)<<16)+((rand()%256)<<24);
+			jt.add(ip, static_cast<char>( rand()%33));
+			if( i == ips/2 )
+				std::cout<<"checkpoint result: "<<journal.checkpoint(jt)<<std::endl;
+		}
+		s = "192.168.0.1/24";
+		at.string2ip(s,&ip,&mask);	 std::cout<<"deleting "<<s<<" "<<"result: "<<jt.del(ip,mask)<<std::endl;
+		std::cout<<"sync result: "<<journal.sync()<<std::endl;
+		auto end = std::chrono::steady_clock::now();
+		std::cout<<"journaled "<<ips<<" prefixes in "<<std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count()<<" ms"<<std::endl;
+		std::cout<<"waiting for checkpoint result: "<<journal.waitCheckpoint()<<std::endl;
+
+		//recover into another table as if the process crashed here
+		AddressTable rt;
+		UpdateJournal recovery("journal");
+		std::cout<<"replayed records: "<<recovery.recover(rt)<<std::endl;
+		std::vector<std::pair<unsigned int, char>> a,b;
+		jt.prefixes(a);
+		rt.prefixes(b);
+		std::cout<<"recovered table matches: "<<(a == b)<<std::endl;
+	}
+
 	return 0;
 }